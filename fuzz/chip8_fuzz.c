@@ -0,0 +1,33 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "../src/chip8.h"
+#include "../src/system.h"
+
+#define FUZZ_FRAMES 60 // one emulated second per input
+
+static config_t config;
+static chip8_t base; // booted machine with an empty ROM, every input starts from a copy of it
+static chip8_t chip8;
+
+// libFuzzer entry point, AFL++ picks it up too when built with afl-clang-fast -fsanitize=fuzzer
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+    static bool initialized = false;
+
+    if (!initialized) {
+        set_config_from_args(&config, 0, NULL);
+        reset_chip8(&base);
+        initialized = true;
+    }
+
+    if (size > sizeof base.ram - ENTRY_POINT) return -1; //init_chip8 rejects these as well
+
+    load_snapshot(&chip8, &base);
+    memcpy(&chip8.ram[ENTRY_POINT], data, size);
+
+    for (uint32_t i = 0; i < FUZZ_FRAMES; i++) {
+        chip8.keypad[i & 0x0F] = !chip8.keypad[i & 0x0F]; //press and release keys so Ex9E/ExA1/Fx0A make progress
+        emulate_frame(&chip8, config);
+    }
+
+    return 0;
+}
@@ -1,8 +1,7 @@
 #include "chip8.h"
 #include "system.h"
 
-bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[]){
-    const uint32_t entry_point = 0x200;
+void reset_chip8(chip8_t *chip8){
     const uint8_t font[] = {
         0xF0, 0x90, 0x90, 0x90, 0xF0,   // 0   
         0x20, 0x60, 0x20, 0x20, 0x70,   // 1  
@@ -25,7 +24,17 @@ bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[]){
     memset(chip8, 0, sizeof(chip8_t));
 
     memcpy(&chip8->ram[0], font, sizeof(font));
-   
+
+    chip8->state = RUNNING;
+    chip8->PC = ENTRY_POINT;
+    chip8->SP = 0;
+    chip8->waited_key = 0xFF;
+    chip8->rng = (uint32_t)rand() | 1;
+}
+
+bool init_chip8(chip8_t *chip8, const char rom_name[]){
+    reset_chip8(chip8);
+
     FILE *rom = fopen(rom_name, "rb");
     if (!rom) {
         SDL_Log("Rom file %s is invalid or does not exist\n", rom_name);
@@ -34,7 +43,7 @@ bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[]){
 
     fseek(rom, 0, SEEK_END);
     const size_t rom_size = ftell(rom);
-    const size_t max_size = sizeof chip8->ram - entry_point;
+    const size_t max_size = sizeof chip8->ram - ENTRY_POINT;
     rewind(rom);
 
     if (rom_size > max_size) {
@@ -43,137 +52,139 @@ bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[]){
         return false;
     }
 
-    if (fread(&chip8->ram[entry_point], rom_size, 1, rom) != 1) {
+    if (fread(&chip8->ram[ENTRY_POINT], rom_size, 1, rom) != 1) {
         SDL_Log("Could not read Rom file %s into CHIP8 memory\n", 
                 rom_name);
         return false;
     }
     fclose(rom);
 
-    chip8->state = RUNNING;
-    chip8->PC = entry_point;
     chip8->rom_name = rom_name;
-    chip8->stack_ptr = &chip8->stack[0];
-    memset(&chip8->pixel_color[0], config.bg_color, sizeof chip8->pixel_color);
 
     return true;
 }
 
-void draw_pixel(
-    const uint32_t i,
-    const uint32_t color,
-    const SDL_Rect rect,
-    const sdl_t sdl,
-    const config_t config,
-    chip8_t *chip8
-){
-            chip8->pixel_color[i] = color;
-            const uint8_t r = (chip8->pixel_color[i] >> 24) & 0xFF;
-            const uint8_t g = (chip8->pixel_color[i] >> 16) & 0xFF;
-            const uint8_t b = (chip8->pixel_color[i] >>  8) & 0xFF;
-            const uint8_t a = (chip8->pixel_color[i] >>  0) & 0xFF;
-
-            SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
-            SDL_RenderFillRect(sdl.renderer, &rect);
+void draw_pixel(const uint32_t color, const SDL_Rect rect, const sdl_t sdl){
+    const uint8_t r = (color >> 24) & 0xFF;
+    const uint8_t g = (color >> 16) & 0xFF;
+    const uint8_t b = (color >>  8) & 0xFF;
+    const uint8_t a = (color >>  0) & 0xFF;
+
+    SDL_SetRenderDrawColor(sdl.renderer, r, g, b, a);
+    SDL_RenderFillRect(sdl.renderer, &rect);
 }
 
-void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8){
+void update_screen(const sdl_t sdl, const config_t config, const frame_t *frame){
     SDL_Rect rect = {.x = 0, .y = 0, .w = config.scale_factor, .h = config.scale_factor};
 
-    for (uint32_t i = 0; i < sizeof chip8->display; i++) {
+    for (uint32_t i = 0; i < sizeof frame->display; i++) {
         rect.x = (i % config.window_width) * config.scale_factor;
         rect.y = (i / config.window_width) * config.scale_factor;
 
-        if (chip8->display[i]) {
-            draw_pixel(i, config.fg_color, rect, sdl, config, chip8);
+        if (frame->display[i]) {
+            draw_pixel(config.fg_color, rect, sdl);
             continue;
         }
 
-        draw_pixel(i, config.bg_color, rect, sdl, config, chip8);
+        draw_pixel(config.bg_color, rect, sdl);
     }
 
     SDL_RenderPresent(sdl.renderer);
 }
 
-void handle_input(chip8_t *chip8){
+static int8_t keypad_index(const SDL_Keycode sym){
+    switch (sym)
+    {
+        case SDLK_1: return 0x1;
+        case SDLK_2: return 0x2;
+        case SDLK_3: return 0x3;
+        case SDLK_4: return 0xC;
+
+        case SDLK_q: return 0x4;
+        case SDLK_w: return 0x5;
+        case SDLK_e: return 0x6;
+        case SDLK_r: return 0xD;
+
+        case SDLK_a: return 0x7;
+        case SDLK_s: return 0x8;
+        case SDLK_d: return 0x9;
+        case SDLK_f: return 0xE;
+
+        case SDLK_z: return 0xA;
+        case SDLK_x: return 0x0;
+        case SDLK_c: return 0xB;
+        case SDLK_v: return 0xF;
+
+        default: return -1;
+    }
+}
+
+//runs on the presentation thread, only forwards events to the emulation thread
+void handle_input(input_queue_t *input, SDL_atomic_t *quit){
     SDL_Event event;
+    int8_t key;
 
     while(SDL_PollEvent(&event)){
         switch (event.type)
         {
             case SDL_QUIT:
-                chip8->state = QUIT;
+                SDL_AtomicSet(quit, true);
                 return;
 
             case SDL_KEYDOWN:
+                if (event.key.repeat) break;
+
                 switch (event.key.keysym.sym)
                 {
                     case SDLK_ESCAPE:
-                        chip8->state = QUIT;
+                        SDL_AtomicSet(quit, true);
                         return;
 
                     case SDLK_SPACE:
-                        if(chip8->state == RUNNING){
-                            chip8->state = PAUSED;
-                            puts("PAUSED");
-                            return;
-                        }
-
-                        chip8->state = RUNNING;
-                        return;
+                        push_input(input, (input_event_t){.type = TOGGLE_PAUSE});
+                        break;
 
-                    case SDLK_1: chip8->keypad[0x1] = true; break;
-                    case SDLK_2: chip8->keypad[0x2] = true; break;
-                    case SDLK_3: chip8->keypad[0x3] = true; break;
-                    case SDLK_4: chip8->keypad[0xC] = true; break;
-
-                    case SDLK_q: chip8->keypad[0x4] = true; break;
-                    case SDLK_w: chip8->keypad[0x5] = true; break;
-                    case SDLK_e: chip8->keypad[0x6] = true; break;
-                    case SDLK_r: chip8->keypad[0xD] = true; break;
-
-                    case SDLK_a: chip8->keypad[0x7] = true; break;
-                    case SDLK_s: chip8->keypad[0x8] = true; break;
-                    case SDLK_d: chip8->keypad[0x9] = true; break;
-                    case SDLK_f: chip8->keypad[0xE] = true; break;
-
-                    case SDLK_z: chip8->keypad[0xA] = true; break;
-                    case SDLK_x: chip8->keypad[0x0] = true; break;
-                    case SDLK_c: chip8->keypad[0xB] = true; break;
-                    case SDLK_v: chip8->keypad[0xF] = true; break;
-                        
                     default:
+                        key = keypad_index(event.key.keysym.sym);
+                        if (key >= 0) push_input(input, (input_event_t){.type = KEY_DOWN, .key = key});
                         break;
                 }
                 break;
 
             case SDL_KEYUP:
-                switch (event.key.keysym.sym) {
-                    case SDLK_1: chip8->keypad[0x1] = false; break;
-                    case SDLK_2: chip8->keypad[0x2] = false; break;
-                    case SDLK_3: chip8->keypad[0x3] = false; break;
-                    case SDLK_4: chip8->keypad[0xC] = false; break;
-
-                    case SDLK_q: chip8->keypad[0x4] = false; break;
-                    case SDLK_w: chip8->keypad[0x5] = false; break;
-                    case SDLK_e: chip8->keypad[0x6] = false; break;
-                    case SDLK_r: chip8->keypad[0xD] = false; break;
-
-                    case SDLK_a: chip8->keypad[0x7] = false; break;
-                    case SDLK_s: chip8->keypad[0x8] = false; break;
-                    case SDLK_d: chip8->keypad[0x9] = false; break;
-                    case SDLK_f: chip8->keypad[0xE] = false; break;
-
-                    case SDLK_z: chip8->keypad[0xA] = false; break;
-                    case SDLK_x: chip8->keypad[0x0] = false; break;
-                    case SDLK_c: chip8->keypad[0xB] = false; break;
-                    case SDLK_v: chip8->keypad[0xF] = false; break;
-
-                    default: break;
-                }
+                key = keypad_index(event.key.keysym.sym);
+                if (key >= 0) push_input(input, (input_event_t){.type = KEY_UP, .key = key});
+                break;
+
+            default: //includes the frame event, it only wakes the presentation thread
+                break;
+        }
+    }
+}
+
+//runs on the emulation thread
+void apply_input(chip8_t *chip8, input_queue_t *input){
+    input_event_t event;
+
+    while(pop_input(input, &event)){
+        switch (event.type)
+        {
+            case KEY_DOWN:
+                chip8->keypad[event.key] = true;
                 break;
 
-            default:
+            case KEY_UP:
+                chip8->keypad[event.key] = false;
+                break;
+
+            case TOGGLE_PAUSE:
+                if(chip8->state == RUNNING){
+                    chip8->state = PAUSED;
+                    puts("PAUSED");
+                    break;
+                }
+
+                chip8->state = RUNNING;
                 break;
         }
     }
@@ -182,7 +193,7 @@ void handle_input(chip8_t *chip8){
 void emulate_instruction(chip8_t *chip8, const config_t config){
     bool carry;
 
-    chip8->inst.opcode = (chip8->ram[chip8->PC] << 8) | chip8->ram[chip8->PC+1]; //16bits
+    chip8->inst.opcode = (chip8->ram[chip8->PC & ADDRESS_MASK] << 8) | chip8->ram[(chip8->PC+1) & ADDRESS_MASK]; //16bits
     chip8->PC += 2; //read 2 byte for time or 16 bits
 
     //smaller part of the opcode
@@ -199,12 +210,13 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
             if (chip8->inst.NN == 0xE0) { //clear screen
                 memset(&chip8->display[0], false, sizeof chip8->display);
                 chip8->draw = true;
-                printf("Clear screen\n");
                 break;
             } 
             
             if(chip8->inst.NN == 0xEE){ //subroutines
-                chip8->PC = *--chip8->stack_ptr;
+                if (chip8->SP == 0) break; //stack underflow, ignore
+
+                chip8->PC = chip8->stack[--chip8->SP];
                 break;
             }
             break;
@@ -214,7 +226,9 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
             break;
 
         case 0x02: //subroutines
-            *chip8->stack_ptr++ = chip8->PC;  
+            if (chip8->SP >= sizeof chip8->stack / sizeof chip8->stack[0]) break; //stack overflow, ignore
+
+            chip8->stack[chip8->SP++] = chip8->PC;
             chip8->PC = chip8->inst.NNN;
             break;
 
@@ -282,7 +296,7 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
                 case 0x06:
                     carry = chip8->V[chip8->inst.Y] & 1;
 
-                    chip8->V[chip8->inst.X] >>= chip8->V[chip8->inst.Y];
+                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] >> 1;
                     chip8->V[0xF] = carry;
                     break;
 
@@ -296,7 +310,7 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
                 case 0x0E:
                     carry = (chip8->V[chip8->inst.Y] & 0x80) >> 7;
 
-                    chip8->V[chip8->inst.X] <<= chip8->V[chip8->inst.Y];
+                    chip8->V[chip8->inst.X] = chip8->V[chip8->inst.Y] << 1;
                     chip8->V[0xF] = carry;
                     break;
                 
@@ -322,7 +336,10 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
             break;
 
         case 0x0C: //set register(V)
-            chip8->V[chip8->inst.X] = (rand() % 256) & chip8->inst.NN;
+            chip8->rng ^= chip8->rng << 13; //xorshift32, kept in chip8_t so snapshots replay the same numbers
+            chip8->rng ^= chip8->rng >> 17;
+            chip8->rng ^= chip8->rng << 5;
+            chip8->V[chip8->inst.X] = (chip8->rng & 0xFF) & chip8->inst.NN;
             break;
 
         case 0x0D: //draw screen
@@ -333,7 +350,7 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
             chip8->V[0xF] = 0; 
 
             for (uint8_t i = 0; i < chip8->inst.N; i++) {
-                const uint8_t sprite_data = chip8->ram[chip8->I + i];
+                const uint8_t sprite_data = chip8->ram[(chip8->I + i) & ADDRESS_MASK];
                 X_coord = orig_X;
 
                 for (int8_t j = 7; j >= 0; j--) {
@@ -356,12 +373,12 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
 
         case 0x0E: //set register(PC)
             if (chip8->inst.NN == 0x9E) {
-                if (chip8->keypad[chip8->V[chip8->inst.X]]) chip8->PC += 2;
+                if (chip8->keypad[chip8->V[chip8->inst.X] & 0x0F]) chip8->PC += 2;
                 break;
             } 
             
             if (chip8->inst.NN == 0xA1) {
-                if (!chip8->keypad[chip8->V[chip8->inst.X]]) chip8->PC += 2;
+                if (!chip8->keypad[chip8->V[chip8->inst.X] & 0x0F]) chip8->PC += 2;
                 break;
             }
             break;
@@ -373,30 +390,27 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
                         break;
 
                     case 0x0A: //set register(PC) or register(V)
-                        static bool any_key_pressed = false;
-                        static uint8_t key = 0xFF;
-
-                        for (uint8_t i = 0; key == 0xFF && i < sizeof chip8->keypad; i++){
+                        for (uint8_t i = 0; chip8->waited_key == 0xFF && i < sizeof chip8->keypad; i++){
                             if (chip8->keypad[i]) {
-                                key = i;
-                                any_key_pressed = true;
+                                chip8->waited_key = i;
+                                chip8->any_key_pressed = true;
                                 break;
                             }
                         }
 
-                        if (!any_key_pressed){
+                        if (!chip8->any_key_pressed){
                             chip8->PC -= 2;
                             break;
                         }
 
-                        if (chip8->keypad[key]){
+                        if (chip8->keypad[chip8->waited_key]){
                             chip8->PC -= 2;
                             break;
                         }
                             
-                        chip8->V[chip8->inst.X] = key;
-                        key = 0xFF;
-                        any_key_pressed = false;
+                        chip8->V[chip8->inst.X] = chip8->waited_key;
+                        chip8->waited_key = 0xFF;
+                        chip8->any_key_pressed = false;
                         break;
 
                     case 0x15: //set delay_timer
@@ -417,22 +431,22 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
 
                     case 0x33:
                         uint8_t bcd = chip8->V[chip8->inst.X]; 
-                        chip8->ram[chip8->I+2] = bcd % 10;
+                        chip8->ram[(chip8->I+2) & ADDRESS_MASK] = bcd % 10;
                         bcd /= 10;
-                        chip8->ram[chip8->I+1] = bcd % 10;
+                        chip8->ram[(chip8->I+1) & ADDRESS_MASK] = bcd % 10;
                         bcd /= 10;
-                        chip8->ram[chip8->I] = bcd;
+                        chip8->ram[chip8->I & ADDRESS_MASK] = bcd;
                         break;
 
                     case 0x55:
                         for (uint8_t i = 0; i <= chip8->inst.X; i++)  {
-                            chip8->ram[chip8->I++] = chip8->V[i];
+                            chip8->ram[chip8->I++ & ADDRESS_MASK] = chip8->V[i];
                         }
                         break;
 
                     case 0x65:
                         for (uint8_t i = 0; i <= chip8->inst.X; i++) {
-                            chip8->V[i] = chip8->ram[chip8->I++];
+                            chip8->V[i] = chip8->ram[chip8->I++ & ADDRESS_MASK];
                         }
                         break;
 
@@ -446,15 +460,34 @@ void emulate_instruction(chip8_t *chip8, const config_t config){
     }
 }
 
-void update_timers(const sdl_t sdl, chip8_t *chip8) {
+void emulate_frame(chip8_t *chip8, const config_t config){
+    for (uint32_t i = 0; i < config.insts_per_second / 60; i++) {
+        emulate_instruction(chip8, config);
+
+        if (chip8->inst.opcode >> 12 == 0xD) break;
+    }
+
+    update_timers(chip8);
+}
+
+void update_timers(chip8_t *chip8) {
     if (chip8->delay_timer > 0) 
         chip8->delay_timer--;
 
-    if (chip8->sound_timer > 0) {
+    chip8->beep = chip8->sound_timer > 0; //sound plays for the frame the timer is ticked down from
+
+    if (chip8->sound_timer > 0)
         chip8->sound_timer--;
-        SDL_PauseAudioDevice(sdl.dev, 0);
-        return;
-    }
+}
+
+void update_sound(const sdl_t sdl, const chip8_t *chip8) {
+    SDL_PauseAudioDevice(sdl.dev, !chip8->beep);
+}
+
+void save_snapshot(const chip8_t *chip8, chip8_t *snapshot) {
+    *snapshot = *chip8;
+}
 
-    SDL_PauseAudioDevice(sdl.dev, 1);
+void load_snapshot(chip8_t *chip8, const chip8_t *snapshot) {
+    *chip8 = *snapshot;
 }
\ No newline at end of file
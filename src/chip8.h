@@ -7,6 +7,11 @@
 #include <stdlib.h>
 
 #include "system.h"
+#include "triple_buffer.h"
+#include "input_queue.h"
+
+#define ENTRY_POINT 0x200
+#define ADDRESS_MASK 0x0FFF // 4 KiB address space, ROMs can point I and PC anywhere
 
 typedef struct {
     uint16_t opcode;
@@ -21,9 +26,8 @@ typedef struct {
     emulator_state_t state;
     uint8_t ram[4096];
     bool display[64*32];
-    uint32_t pixel_color[64*32];
     uint16_t stack[12];
-    uint16_t *stack_ptr;
+    uint8_t SP;
     uint8_t V[16];
     uint16_t PC;
     uint16_t I; 
@@ -33,21 +37,24 @@ typedef struct {
     const char *rom_name; 
     instruction_t inst;
     bool draw;
-} chip8_t;
-
-bool init_chip8(chip8_t *chip8, const config_t config, const char rom_name[]);
-void draw_pixel(
-    const uint32_t i,
-    const uint32_t color,
-    const SDL_Rect rect,
-    const sdl_t sdl,
-    const config_t config,
-    chip8_t *chip8
-);
-void update_screen(const sdl_t sdl, const config_t config, chip8_t *chip8);
-void handle_input(chip8_t *chip8);
+    bool beep;
+    bool any_key_pressed; //Fx0A key wait
+    uint8_t waited_key;
+    uint32_t rng;
+} chip8_t; //holds no pointers into itself, a plain copy is a full snapshot
+
+void reset_chip8(chip8_t *chip8);
+bool init_chip8(chip8_t *chip8, const char rom_name[]);
+void draw_pixel(const uint32_t color, const SDL_Rect rect, const sdl_t sdl);
+void update_screen(const sdl_t sdl, const config_t config, const frame_t *frame);
+void handle_input(input_queue_t *input, SDL_atomic_t *quit);
+void apply_input(chip8_t *chip8, input_queue_t *input);
 void emulate_instruction(chip8_t *chip8, const config_t config);
-void update_timers(const sdl_t sdl, chip8_t *chip8);
+void emulate_frame(chip8_t *chip8, const config_t config);
+void update_timers(chip8_t *chip8);
+void update_sound(const sdl_t sdl, const chip8_t *chip8);
+void save_snapshot(const chip8_t *chip8, chip8_t *snapshot);
+void load_snapshot(chip8_t *chip8, const chip8_t *snapshot);
 
 
 #endif
\ No newline at end of file
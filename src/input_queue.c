@@ -0,0 +1,28 @@
+#include "input_queue.h"
+
+bool push_input(input_queue_t *queue, const input_event_t event){
+    const uint32_t head = SDL_AtomicGet(&queue->head);
+    const uint32_t tail = SDL_AtomicGet(&queue->tail);
+
+    if (head - tail >= INPUT_QUEUE_SIZE) {
+        SDL_AtomicAdd(&queue->dropped, 1);
+        return false;
+    }
+
+    queue->events[head & (INPUT_QUEUE_SIZE - 1)] = event;
+    SDL_AtomicSet(&queue->head, head + 1);
+
+    return true;
+}
+
+bool pop_input(input_queue_t *queue, input_event_t *event){
+    const uint32_t tail = SDL_AtomicGet(&queue->tail);
+    const uint32_t head = SDL_AtomicGet(&queue->head);
+
+    if (head == tail) return false;
+
+    *event = queue->events[tail & (INPUT_QUEUE_SIZE - 1)];
+    SDL_AtomicSet(&queue->tail, tail + 1);
+
+    return true;
+}
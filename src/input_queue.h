@@ -0,0 +1,32 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+#define INPUT_QUEUE_SIZE 64 // must be a power of two
+
+typedef enum {
+    KEY_DOWN,
+    KEY_UP,
+    TOGGLE_PAUSE,
+} input_type_t;
+
+typedef struct {
+    input_type_t type;
+    uint8_t key;
+} input_event_t;
+
+// single producer (presentation thread) / single consumer (emulation thread) ring, wait-free on both ends
+typedef struct {
+    input_event_t events[INPUT_QUEUE_SIZE];
+    SDL_atomic_t head; // written only by the presentation thread
+    SDL_atomic_t tail; // written only by the emulation thread
+    SDL_atomic_t dropped;
+} input_queue_t;
+
+bool push_input(input_queue_t *queue, const input_event_t event);
+bool pop_input(input_queue_t *queue, input_event_t *event);
+
+#endif
@@ -2,10 +2,100 @@
 #include <stdint.h>
 #include "system.h"
 #include "chip8.h"
+#include "triple_buffer.h"
+#include "input_queue.h"
+
+typedef struct {
+    chip8_t chip8;
+    chip8_t snapshot;
+    config_t config;
+    sdl_t sdl;
+    triple_buffer_t frames;
+    input_queue_t input;
+    SDL_atomic_t quit;
+    uint32_t frame_event; //wakes the presentation thread when a frame is published
+    uint64_t run_ahead_ticks; //only touched by the emulation thread, read after it is joined
+    uint64_t run_ahead_max_ticks;
+    uint64_t run_ahead_host_frames;
+} emulator_t;
+
+static void wait_until(const uint64_t deadline, const uint64_t frequency){
+    const uint64_t now = SDL_GetPerformanceCounter();
+    if (now >= deadline) return;
+
+    //sleep most of the way, then spin the last millisecond so frames start on time
+    const uint32_t remaining_ms = (deadline - now) * 1000 / frequency;
+    if (remaining_ms > 1) SDL_Delay(remaining_ms - 1);
+
+    while (SDL_GetPerformanceCounter() < deadline);
+}
+
+static void publish_display(emulator_t *emu){
+    memcpy(back_frame(&emu->frames)->display, emu->chip8.display, sizeof emu->chip8.display);
+    if(publish_frame(&emu->frames)){
+        SDL_PushEvent(&(SDL_Event){.type = emu->frame_event});
+    }
+}
+
+//present the frame the game will show run_ahead_frames from now with the current input, then rewind
+static void run_ahead(emulator_t *emu){
+    chip8_t *chip8 = &emu->chip8;
+
+    save_snapshot(chip8, &emu->snapshot);
+
+    for (int32_t i = 0; i < emu->config.run_ahead_frames; i++) {
+        emulate_frame(chip8, emu->config);
+    }
+
+    publish_display(emu); //every host frame, so a mispredicted future frame is replaced even when nothing draws
+
+    load_snapshot(chip8, &emu->snapshot);
+}
+
+static int emulation_thread(void *data){
+    emulator_t *emu = data;
+    chip8_t *chip8 = &emu->chip8;
+
+    const uint64_t frequency = SDL_GetPerformanceFrequency();
+    const uint64_t frame_ticks = frequency / 60;
+    uint64_t deadline = SDL_GetPerformanceCounter() + frame_ticks;
+
+    while(!SDL_AtomicGet(&emu->quit)){
+        apply_input(chip8, &emu->input);
+
+        if(chip8->state == RUNNING){
+            const uint64_t start_frame_time = SDL_GetPerformanceCounter();
+
+            emulate_frame(chip8, emu->config);
+            update_sound(emu->sdl, chip8);
+
+            if(emu->config.run_ahead_frames){
+                run_ahead(emu);
+
+                const uint64_t elapsed = SDL_GetPerformanceCounter() - start_frame_time;
+                emu->run_ahead_ticks += elapsed;
+                emu->run_ahead_host_frames++;
+                if (elapsed > emu->run_ahead_max_ticks) emu->run_ahead_max_ticks = elapsed;
+            } else if(chip8->draw){
+                publish_display(emu);
+            }
+
+            chip8->draw = false;
+        }
+
+        wait_until(deadline, frequency);
+        deadline += frame_ticks;
+
+        const uint64_t now = SDL_GetPerformanceCounter();
+        if (now > deadline) deadline = now + frame_ticks; //fell a whole frame behind, resync instead of bursting
+    }
+
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-       fprintf(stderr, "Usage: %s <rom_name>\n", argv[0]);
+       fprintf(stderr, "Usage: %s <rom_name> [--run-ahead <1-%d>]\n", argv[0], MAX_RUN_AHEAD_FRAMES);
        exit(EXIT_FAILURE);
     }
 
@@ -15,38 +105,57 @@ int main(int argc, char *argv[]) {
     sdl_t sdl = {0};
     if(!init_sdl(&sdl, &config)) exit(EXIT_FAILURE);
 
-    chip8_t chip8 = {0};
+    static emulator_t emu = {0};
     const char *rom_name = argv[1];
-    if(!init_chip8(&chip8, config, rom_name)) exit(EXIT_FAILURE);
+    if(!init_chip8(&emu.chip8, rom_name)) exit(EXIT_FAILURE);
 
-    clear_screen(sdl, config);
+    emu.config = config;
+    emu.sdl = sdl;
+    init_triple_buffer(&emu.frames);
 
-    while(chip8.state != QUIT){
-        handle_input(&chip8);
+    emu.frame_event = SDL_RegisterEvents(1);
+    if(emu.frame_event == (uint32_t)-1){
+        SDL_Log("Could not register frame event! %s\n", SDL_GetError());
+        final_cleanup(sdl);
+        exit(EXIT_FAILURE);
+    }
 
-        if(chip8.state == PAUSED) {
-            SDL_Delay(41.5f); // ≈ 24 fps
-            continue;
-        };
+    clear_screen(sdl, config);
+
+    SDL_Thread *thread = SDL_CreateThread(emulation_thread, "chip8 emulation", &emu);
+    if(!thread){
+        SDL_Log("Could not create emulation thread! %s\n", SDL_GetError());
+        final_cleanup(sdl);
+        exit(EXIT_FAILURE);
+    }
 
-        const uint64_t start_frame_time = SDL_GetPerformanceCounter();
-        for (uint32_t i = 0; i < config.insts_per_second / 60; i++) {
-            emulate_instruction(&chip8, config);
+    while(!SDL_AtomicGet(&emu.quit)){
+        handle_input(&emu.input, &emu.quit);
 
-            if (chip8.inst.opcode >> 12 == 0xD) break;
+        const frame_t *frame = acquire_frame(&emu.frames);
+        if(!frame){
+            SDL_WaitEventTimeout(NULL, 100); //sleep until input or a new frame arrives, leaves the event queued
+            continue;
         }
-        const uint64_t end_frame_time = SDL_GetPerformanceCounter();
 
-        const double time_elapsed = (double)((end_frame_time - start_frame_time) * 1000) / SDL_GetPerformanceFrequency();
+        update_screen(sdl, config, frame);
+    }
+
+    SDL_WaitThread(thread, NULL);
 
-        SDL_Delay(16.67f > time_elapsed ? 16.67f - time_elapsed : 0);
+    printf("Frames produced: %d, presented: %d, skipped: %d, input events dropped: %d\n",
+           SDL_AtomicGet(&emu.frames.produced),
+           SDL_AtomicGet(&emu.frames.presented),
+           SDL_AtomicGet(&emu.frames.skipped),
+           SDL_AtomicGet(&emu.input.dropped));
 
-        if(chip8.draw){
-            update_screen(sdl, config, &chip8);
-            chip8.draw = false;
-        }
+    if(emu.run_ahead_host_frames){
+        const double us_per_tick = 1000000.0 / SDL_GetPerformanceFrequency();
 
-        update_timers(sdl, &chip8);
+        printf("Run-ahead %d frames: avg %.1f us, max %.1f us per host frame (budget 16667 us)\n",
+               config.run_ahead_frames,
+               emu.run_ahead_ticks * us_per_tick / emu.run_ahead_host_frames,
+               emu.run_ahead_max_ticks * us_per_tick);
     }
 
     final_cleanup(sdl);
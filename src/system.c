@@ -11,10 +11,33 @@ bool set_config_from_args(config_t *config, const int argc, char **argv){
         .square_wave_freq = 440,
         .audio_sample_rate = 44100,
         .volume = 3000, 
+        .run_ahead_frames = 0,
     };
 
-    for(int i = 0; i < argc; i++){
-        argv[i];
+    if(argc > 1 && strncmp(argv[1], "--", 2) == 0){
+        SDL_Log("Rom file must come before options, got %s\n", argv[1]);
+        return false;
+    }
+
+    for(int i = 2; i < argc; i++){
+        if(strcmp(argv[i], "--run-ahead") != 0){
+            SDL_Log("Unknown option %s\n", argv[i]);
+            return false;
+        }
+
+        if(i + 1 >= argc){
+            SDL_Log("Missing value for --run-ahead\n");
+            return false;
+        }
+
+        char *end;
+        config->run_ahead_frames = strtol(argv[++i], &end, 10);
+
+        if(end == argv[i] || *end != '\0' ||
+           config->run_ahead_frames < 1 || config->run_ahead_frames > MAX_RUN_AHEAD_FRAMES){
+            SDL_Log("Run-ahead must be between 1 and %d frames, got %s\n", MAX_RUN_AHEAD_FRAMES, argv[i]);
+            return false;
+        }
     }
 
     return true;
@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 
+#define MAX_RUN_AHEAD_FRAMES 4
+
 typedef struct {
     uint32_t window_width;
     uint32_t window_height;
@@ -15,6 +17,7 @@ typedef struct {
     uint32_t square_wave_freq;
     uint32_t audio_sample_rate; 
     int16_t volume; 
+    int32_t run_ahead_frames; //0 = off
 } config_t;
 
 typedef struct {
@@ -0,0 +1,39 @@
+#include "triple_buffer.h"
+
+void init_triple_buffer(triple_buffer_t *buffer){
+    memset(buffer, 0, sizeof(triple_buffer_t));
+
+    buffer->back = 0;
+    SDL_AtomicSet(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+frame_t *back_frame(triple_buffer_t *buffer){
+    return &buffer->frames[buffer->back];
+}
+
+//returns true when the presentation thread had already taken the previous frame and may be waiting for this one
+bool publish_frame(triple_buffer_t *buffer){
+    const int previous = SDL_AtomicSet(&buffer->middle, buffer->back | FRAME_READY);
+
+    if (previous & FRAME_READY) {
+        SDL_AtomicAdd(&buffer->skipped, 1); //overwritten before it was presented
+    }
+
+    buffer->back = previous & FRAME_INDEX_MASK;
+    SDL_AtomicAdd(&buffer->produced, 1);
+
+    return !(previous & FRAME_READY);
+}
+
+const frame_t *acquire_frame(triple_buffer_t *buffer){
+    if (!(SDL_AtomicGet(&buffer->middle) & FRAME_READY)) return NULL;
+
+    //the emulation thread may have published again since the check, the swap still takes the newest frame
+    const int previous = SDL_AtomicSet(&buffer->middle, buffer->front);
+
+    buffer->front = previous & FRAME_INDEX_MASK;
+    SDL_AtomicAdd(&buffer->presented, 1);
+
+    return &buffer->frames[buffer->front];
+}
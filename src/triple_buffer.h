@@ -0,0 +1,31 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+#define FRAME_INDEX_MASK 0x3
+#define FRAME_READY 0x4 // middle frame holds a frame the presentation thread has not taken yet
+
+typedef struct {
+    bool display[64*32];
+} frame_t;
+
+// single producer (emulation thread) / single consumer (presentation thread), never blocks either side
+typedef struct {
+    frame_t frames[3];
+    SDL_atomic_t middle; // index of the shared frame | FRAME_READY
+    uint8_t back;        // owned by the emulation thread
+    uint8_t front;       // owned by the presentation thread
+    SDL_atomic_t produced;
+    SDL_atomic_t presented;
+    SDL_atomic_t skipped;
+} triple_buffer_t;
+
+void init_triple_buffer(triple_buffer_t *buffer);
+frame_t *back_frame(triple_buffer_t *buffer);
+bool publish_frame(triple_buffer_t *buffer);
+const frame_t *acquire_frame(triple_buffer_t *buffer);
+
+#endif